@@ -1,4 +1,4 @@
-%define sover   0
+%define sover   1
 %define libname libtinyframe%{sover}
 Name:           tinyframe
 Version:        0.1.1
@@ -25,6 +25,8 @@
 
 #include <assert.h>
 #include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
 #ifdef HAVE_ENDIAN_H
 #include <endian.h>
 #else
@@ -79,11 +81,242 @@ int main(void)
     // too small buffer
     assert(tinyframe_write_control_start(&writer, out, 1, "test", 4) == tinyframe_need_more);
 
+    // too large control field
+    assert(tinyframe_write_control_ready(&writer, out, sizeof(out), "test", TINYFRAME_CONTROL_FIELD_CONTENT_TYPE_LENGTH_MAX + 1) == tinyframe_error);
+    assert(tinyframe_write_control_accept(&writer, out, sizeof(out), "test", TINYFRAME_CONTROL_FIELD_CONTENT_TYPE_LENGTH_MAX + 1) == tinyframe_error);
+
+    // too small buffer
+    assert(tinyframe_write_control_ready(&writer, out, 1, "test", 4) == tinyframe_need_more);
+    assert(tinyframe_write_control_accept(&writer, out, 1, "test", 4) == tinyframe_need_more);
+
+    // correct handshake, sender
+    {
+        struct tinyframe_reader reader = TINYFRAME_READER_INITIALIZER;
+
+        assert(tinyframe_write_control_ready(&writer, out, sizeof(out), "test", 4) == tinyframe_ok);
+        assert(writer.bytes_wrote == 24);
+        assert(tinyframe_read(&reader, out, writer.bytes_wrote) == tinyframe_have_control);
+        assert(reader.control.type == TINYFRAME_CONTROL_READY);
+        assert(tinyframe_read(&reader, out + 12, writer.bytes_wrote - 12) == tinyframe_have_control_field);
+        assert(reader.control_field.length == 4 && !memcmp(reader.control_field.data, "test", 4));
+    }
+
+    // correct handshake, receiver
+    {
+        struct tinyframe_reader reader = TINYFRAME_READER_INITIALIZER;
+
+        assert(tinyframe_write_control_accept(&writer, out, sizeof(out), "test", 4) == tinyframe_ok);
+        assert(tinyframe_read(&reader, out, writer.bytes_wrote) == tinyframe_have_control);
+        assert(reader.control.type == TINYFRAME_CONTROL_ACCEPT);
+    }
+
+    // correct finish
+    {
+        struct tinyframe_reader reader = TINYFRAME_READER_INITIALIZER;
+
+        assert(tinyframe_write_control_finish(&writer, out, sizeof(out)) == tinyframe_ok);
+        assert(writer.bytes_wrote == 12);
+        assert(tinyframe_read(&reader, out, writer.bytes_wrote) == tinyframe_finished);
+    }
+
     // too small buffer
     assert(tinyframe_write_frame(&writer, out, 1, out, 4) == tinyframe_need_more);
 
     // too small buffer
     assert(tinyframe_write_control_stop(&writer, out, 1) == tinyframe_need_more);
+    assert(tinyframe_write_control_finish(&writer, out, 1) == tinyframe_need_more);
+
+    // partial reads, bytes needed
+    {
+        struct tinyframe_reader reader = TINYFRAME_READER_INITIALIZER;
+        size_t                  wrote;
+
+        assert(tinyframe_write_control_start(&writer, out, sizeof(out), "test", 4) == tinyframe_ok);
+        wrote = writer.bytes_wrote;
+        assert(tinyframe_write_frame(&writer, out + wrote, sizeof(out) - wrote, (uint8_t*)"frame", 5) == tinyframe_ok);
+
+        assert(tinyframe_read(&reader, out, 1) == tinyframe_need_more);
+        assert(reader.bytes_needed == 12);
+        assert(tinyframe_read(&reader, out, 12) == tinyframe_have_control);
+        assert(tinyframe_read(&reader, out + 12, 1) == tinyframe_need_more);
+        assert(reader.bytes_needed == 8);
+        assert(tinyframe_read(&reader, out + 12, 8) == tinyframe_need_more);
+        assert(reader.bytes_needed == 12);
+        assert(tinyframe_read(&reader, out + 12, 12) == tinyframe_have_control_field);
+        assert(tinyframe_read(&reader, out + wrote, 1) == tinyframe_need_more);
+        assert(reader.bytes_needed == 4);
+        assert(tinyframe_read(&reader, out + wrote, 4) == tinyframe_need_more);
+        assert(reader.bytes_needed == 9);
+        assert(tinyframe_read(&reader, out + wrote, 9) == tinyframe_have_frame);
+    }
+
+    // reset after stop, next stream
+    {
+        struct tinyframe_reader reader = TINYFRAME_READER_INITIALIZER;
+
+        assert(tinyframe_write_control_stop(&writer, out, sizeof(out)) == tinyframe_ok);
+        assert(tinyframe_read(&reader, out, writer.bytes_wrote) == tinyframe_stopped);
+        assert(tinyframe_read(&reader, out, writer.bytes_wrote) == tinyframe_error);
+
+        assert(tinyframe_write_control_start(&writer, out, sizeof(out), "test", 4) == tinyframe_ok);
+        tinyframe_reader_reset(&reader);
+        assert(reader.state == tinyframe_control);
+        assert(tinyframe_read(&reader, out, writer.bytes_wrote) == tinyframe_have_control);
+        assert(reader.control.type == TINYFRAME_CONTROL_START);
+    }
+
+    // batch of frames
+    {
+        struct tinyframe frames[3] = {
+            { 5, (uint8_t*)"frame" },
+            { 3, (uint8_t*)"abc" },
+            { 4, (uint8_t*)"test" },
+        };
+        uint8_t one[64];
+        size_t  wrote = 0, written;
+
+        assert(tinyframe_write_frame(&writer, one, sizeof(one), frames[0].data, frames[0].length) == tinyframe_ok);
+        wrote += writer.bytes_wrote;
+        assert(tinyframe_write_frame(&writer, one + wrote, sizeof(one) - wrote, frames[1].data, frames[1].length) == tinyframe_ok);
+        wrote += writer.bytes_wrote;
+        assert(tinyframe_write_frame(&writer, one + wrote, sizeof(one) - wrote, frames[2].data, frames[2].length) == tinyframe_ok);
+        wrote += writer.bytes_wrote;
+
+        assert(tinyframe_write_frames(&writer, out, sizeof(out), frames, 3, &written) == tinyframe_ok);
+        assert(written == 3);
+        assert(writer.bytes_wrote == wrote);
+        assert(!memcmp(out, one, wrote));
+
+        // too small buffer, partial
+        assert(tinyframe_write_frames(&writer, out, wrote - 1, frames, 3, &written) == tinyframe_need_more);
+        assert(written == 2);
+        assert(writer.bytes_wrote == 16);
+        assert(tinyframe_write_frames(&writer, out, 3, frames, 3, &written) == tinyframe_need_more);
+        assert(written == 0);
+        assert(writer.bytes_wrote == 0);
+
+        // zero length frame, would be a control frame "escape"
+        frames[1].length = 0;
+        assert(tinyframe_write_frames(&writer, out, sizeof(out), frames, 3, &written) == tinyframe_error);
+        assert(written == 0);
+        frames[1].length = 3;
+
+        // nothing to write
+        assert(tinyframe_write_frames(&writer, out, sizeof(out), 0, 0, &written) == tinyframe_ok);
+        assert(written == 0);
+    }
+
+    // frame length would wrap, too small buffer
+    assert(tinyframe_write_frame(&writer, out, sizeof(out), out, UINT32_MAX) == tinyframe_need_more);
+
+    // absolute stream offsets beyond 4GB
+    {
+        struct tinyframe_writer w      = TINYFRAME_WRITER_INITIALIZER;
+        struct tinyframe_reader reader = TINYFRAME_READER_INITIALIZER;
+        uint64_t                base   = (uint64_t)UINT32_MAX + 10;
+        size_t                  wrote, written;
+        struct tinyframe        frames[2] = {
+            { 5, (uint8_t*)"frame" },
+            { 4, (uint8_t*)"test" },
+        };
+
+        w.bytes_total = base;
+        assert(tinyframe_write_control_start(&w, out, sizeof(out), "test", 4) == tinyframe_ok);
+        assert(w.offset == base && w.bytes_total == base + 24);
+        wrote = w.bytes_wrote;
+        assert(tinyframe_write_frame(&w, out + wrote, sizeof(out) - wrote, frames[0].data, frames[0].length) == tinyframe_ok);
+        assert(w.offset == base + 24 && w.bytes_total == base + 33);
+        wrote += w.bytes_wrote;
+        assert(tinyframe_write_frames(&w, out + wrote, sizeof(out) - wrote, frames, 2, &written) == tinyframe_ok);
+        assert(w.offset == base + 33 && w.bytes_total == base + 50);
+        wrote += w.bytes_wrote;
+
+        // nothing fits, offset unchanged
+        assert(tinyframe_write_frames(&w, out, 3, frames, 2, &written) == tinyframe_need_more);
+        assert(written == 0 && w.bytes_wrote == 0);
+        assert(w.offset == base + 33 && w.bytes_total == base + 50);
+
+        reader.bytes_total = base;
+        assert(tinyframe_read(&reader, out, wrote) == tinyframe_have_control);
+        assert(reader.offset == base);
+        assert(tinyframe_read(&reader, out + 12, wrote - 12) == tinyframe_have_control_field);
+        assert(reader.offset == base + 12);
+        assert(tinyframe_read(&reader, out + 24, 1) == tinyframe_need_more);
+        assert(reader.offset == base + 12 && reader.bytes_total == base + 24);
+        assert(tinyframe_read(&reader, out + 24, wrote - 24) == tinyframe_have_frame);
+        assert(reader.offset == base + 24);
+        assert(tinyframe_read(&reader, out + 33, wrote - 33) == tinyframe_have_frame);
+        assert(tinyframe_read(&reader, out + 42, wrote - 42) == tinyframe_have_frame);
+        assert(reader.offset == base + 42 && reader.bytes_total == base + 50);
+    }
+
+    // verify and stats
+    {
+        struct tinyframe_stats stats;
+        size_t                 wrote, start_len;
+
+        assert(tinyframe_write_control_start(&writer, out, sizeof(out), "test", 4) == tinyframe_ok);
+        wrote = start_len = writer.bytes_wrote;
+        assert(tinyframe_write_frame(&writer, out + wrote, sizeof(out) - wrote, (uint8_t*)"frame", 5) == tinyframe_ok);
+        wrote += writer.bytes_wrote;
+        assert(tinyframe_write_frame(&writer, out + wrote, sizeof(out) - wrote, (uint8_t*)"abc", 3) == tinyframe_ok);
+        wrote += writer.bytes_wrote;
+        assert(tinyframe_write_control_stop(&writer, out + wrote, sizeof(out) - wrote) == tinyframe_ok);
+        wrote += writer.bytes_wrote;
+
+        assert(tinyframe_verify(out, wrote, &stats) == tinyframe_ok);
+        assert(stats.frames == 2 && stats.frame_bytes == 8);
+        assert(stats.frame_length_min == 3 && stats.frame_length_max == 5);
+        assert(stats.bytes == wrote);
+
+        // truncated, no stop
+        assert(tinyframe_verify(out, wrote - 12, &stats) == tinyframe_need_more);
+        assert(stats.frames == 2 && stats.bytes == wrote - 12);
+        assert(tinyframe_verify(out, wrote - 13, &stats) == tinyframe_need_more);
+        assert(stats.frames == 1 && stats.bytes == start_len + 9);
+
+        // data after stop
+        assert(tinyframe_verify(out, wrote + 1, &stats) == tinyframe_error);
+
+        // stop without start
+        assert(tinyframe_verify(out + wrote - 12, 12, &stats) == tinyframe_error);
+
+        // second start
+        assert(tinyframe_write_control_start(&writer, out + start_len + 9, sizeof(out) - start_len - 9, "test", 4) == tinyframe_ok);
+        assert(tinyframe_verify(out, start_len + 9 + writer.bytes_wrote, &stats) == tinyframe_error);
+        assert(stats.frames == 1 && stats.bytes == start_len + 9);
+
+        // ready first
+        assert(tinyframe_write_control_ready(&writer, out, sizeof(out), "test", 4) == tinyframe_ok);
+        assert(tinyframe_verify(out, sizeof(out), &stats) == tinyframe_error);
+        assert(stats.bytes == 0);
+    }
+
+#if SIZE_MAX > UINT32_MAX && defined(MAP_NORESERVE)
+    // frame length beyond 32 bit sizes, read through a sparse mapping
+    {
+        size_t   map_len = 24 + 4 + (size_t)UINT32_MAX;
+        uint8_t* map     = mmap(0, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+        if (map != MAP_FAILED) {
+            struct tinyframe_reader reader = TINYFRAME_READER_INITIALIZER;
+
+            assert(tinyframe_write_control_start(&writer, map, map_len, "test", 4) == tinyframe_ok);
+            tinyframe_set_header(map + 24, UINT32_MAX);
+
+            assert(tinyframe_read(&reader, map, map_len) == tinyframe_have_control);
+            assert(tinyframe_read(&reader, map + 12, map_len - 12) == tinyframe_have_control_field);
+            assert(tinyframe_read(&reader, map + 24, map_len - 24 - 1) == tinyframe_need_more);
+            assert(reader.bytes_needed == 4 + (size_t)UINT32_MAX);
+            assert(tinyframe_read(&reader, map + 24, map_len - 24) == tinyframe_have_frame);
+            assert(reader.frame.length == UINT32_MAX);
+            assert(reader.bytes_read == 4 + (size_t)UINT32_MAX);
+            assert(reader.offset == 24 && reader.bytes_total == map_len);
+
+            munmap(map, map_len);
+        }
+    }
+#endif
 
     // correct
     tinyframe_set_header(out, 111);
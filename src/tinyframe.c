@@ -36,13 +36,31 @@
 #endif
 #endif
 #include <assert.h>
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define probe_read(result, handle) DTRACE_PROBE3(tinyframe, read, result, (handle)->state, (handle)->bytes_read)
+#define probe_need_more(handle) DTRACE_PROBE1(tinyframe, need_more, (handle)->bytes_needed)
+#define probe_write_control(type, len) DTRACE_PROBE2(tinyframe, write_control, type, len)
+#define probe_write_frame(len) DTRACE_PROBE1(tinyframe, write_frame, len)
+#define probe_write_need_more(needed, len) DTRACE_PROBE2(tinyframe, write_need_more, needed, len)
+#define probe_write_error(type) DTRACE_PROBE1(tinyframe, write_error, type)
+#else
+#define probe_read(x...)
+#define probe_need_more(x...)
+#define probe_write_control(x...)
+#define probe_write_frame(x...)
+#define probe_write_need_more(x...)
+#define probe_write_error(x...)
+#endif
 #ifdef TINYFRAME_TRACE
 #include <stdio.h>
 #include <ctype.h>
+#include <inttypes.h>
 static const char* printable_string(const uint8_t* data, size_t len)
 {
-    static char buf[512], hex;
-    size_t      r = 0, w = 0;
+    static __thread char buf[512];
+    char                 hex;
+    size_t               r = 0, w = 0;
 
     while (r < len && w < sizeof(buf) - 1) {
         if (isprint(data[r])) {
@@ -76,11 +94,7 @@ static const char* printable_string(const uint8_t* data, size_t len)
 
     return buf;
 }
-#define trace(x...)                                \
-    fprintf(stderr, "tinyframe %s(): ", __func__); \
-    fprintf(stderr, x);                            \
-    fprintf(stderr, "\n");                         \
-    fflush(stderr);
+#define trace(fmt, x...) fprintf(stderr, "tinyframe %s(): " fmt "\n", __func__, ##x)
 #else
 #define trace(x...)
 #define printable_string(x...)
@@ -117,10 +131,20 @@ static inline void _put32(void* ptr, uint32_t v)
     memcpy(ptr, &be_v, sizeof(be_v));
 }
 
+static inline void __wrote(struct tinyframe_writer* handle, size_t bytes)
+{
+    handle->bytes_wrote = bytes;
+    if (bytes) {
+        handle->offset = handle->bytes_total;
+        handle->bytes_total += bytes;
+    }
+}
+
 static inline enum tinyframe_result __read_control(struct tinyframe_reader* handle, const uint8_t* data, size_t len)
 {
     if (len < 12) {
         trace("data len %zu < 12, need more", len);
+        handle->bytes_needed = 12;
         return tinyframe_need_more;
     }
     handle->control.length = _need32(data); // "escape"
@@ -169,11 +193,8 @@ static inline enum tinyframe_result __read_control(struct tinyframe_reader* hand
     return tinyframe_have_control;
 }
 
-enum tinyframe_result tinyframe_read(struct tinyframe_reader* handle, const uint8_t* data, size_t len)
+static inline enum tinyframe_result __read(struct tinyframe_reader* handle, const uint8_t* data, size_t len)
 {
-    assert(handle);
-    assert(data);
-
     switch (handle->state) {
     case tinyframe_control:
         return __read_control(handle, data, len);
@@ -181,6 +202,7 @@ enum tinyframe_result tinyframe_read(struct tinyframe_reader* handle, const uint
     case tinyframe_control_field:
         if (len < 8) {
             trace("data len %zu < 8 for control field, need more", len);
+            handle->bytes_needed = 8;
             return tinyframe_need_more;
         }
         handle->control_field.type = _need32(data);
@@ -199,6 +221,7 @@ enum tinyframe_result tinyframe_read(struct tinyframe_reader* handle, const uint
         }
         if (len - 8 < handle->control_field.length) {
             trace("data len %zu < control field length, need more", len - 8);
+            handle->bytes_needed = 8 + handle->control_field.length;
             return tinyframe_need_more;
         }
 
@@ -221,6 +244,7 @@ enum tinyframe_result tinyframe_read(struct tinyframe_reader* handle, const uint
     case tinyframe_frame:
         if (len < 4) {
             trace("data len %zu < 4 for frame, need more", len);
+            handle->bytes_needed = 4;
             return tinyframe_need_more;
         }
         handle->frame.length = _need32(data);
@@ -229,13 +253,20 @@ enum tinyframe_result tinyframe_read(struct tinyframe_reader* handle, const uint
             return __read_control(handle, data, len);
         }
 
+#if SIZE_MAX <= UINT32_MAX
+        if (handle->frame.length > SIZE_MAX - 4) {
+            trace("frame length larger than address space, error");
+            return tinyframe_error;
+        }
+#endif
         if (len - 4 < handle->frame.length) {
             trace("data len %zu < frame length, need more", len - 4);
+            handle->bytes_needed = 4 + (size_t)handle->frame.length;
             return tinyframe_need_more;
         }
 
         handle->frame.data = data + 4;
-        handle->bytes_read = 4 + handle->frame.length;
+        handle->bytes_read = 4 + (size_t)handle->frame.length;
         trace("frame data [%zu]: %s...", handle->bytes_read, printable_string(data, handle->bytes_read > 20 ? 20 : handle->bytes_read));
         return tinyframe_have_frame;
 
@@ -246,6 +277,108 @@ enum tinyframe_result tinyframe_read(struct tinyframe_reader* handle, const uint
     return tinyframe_error;
 }
 
+enum tinyframe_result tinyframe_read(struct tinyframe_reader* handle, const uint8_t* data, size_t len)
+{
+    enum tinyframe_result res;
+
+    assert(handle);
+    assert(data);
+
+    res = __read(handle, data, len);
+    switch (res) {
+    case tinyframe_have_control:
+    case tinyframe_have_control_field:
+    case tinyframe_have_frame:
+    case tinyframe_stopped:
+    case tinyframe_finished:
+        handle->offset = handle->bytes_total;
+        handle->bytes_total += handle->bytes_read;
+        probe_read(res, handle);
+        break;
+    case tinyframe_need_more:
+        probe_need_more(handle);
+        break;
+    default:
+        probe_read(res, handle);
+        break;
+    }
+
+    return res;
+}
+
+void tinyframe_reader_reset(struct tinyframe_reader* handle)
+{
+    static const struct tinyframe_reader init = TINYFRAME_READER_INITIALIZER;
+
+    assert(handle);
+
+    *handle = init;
+}
+
+enum tinyframe_result tinyframe_verify(const uint8_t* data, size_t len, struct tinyframe_stats* stats)
+{
+    struct tinyframe_reader reader = TINYFRAME_READER_INITIALIZER;
+    struct tinyframe_stats  s      = TINYFRAME_STATS_INITIALIZER;
+    enum tinyframe_result   res;
+    int                     started = 0;
+
+    assert(data);
+    assert(stats);
+
+    while (1) {
+        res = tinyframe_read(&reader, data, len);
+        switch (res) {
+        case tinyframe_have_control:
+            // a stream has one START first and no other control frames
+            // until STOP
+            if (started || reader.control.type != TINYFRAME_CONTROL_START) {
+                trace("control %u at %" PRIu64 " unexpected, error", reader.control.type, reader.offset);
+                *stats = s;
+                return tinyframe_error;
+            }
+            started = 1;
+            break;
+
+        case tinyframe_have_control_field:
+            break;
+
+        case tinyframe_have_frame:
+            if (!s.frames || reader.frame.length < s.frame_length_min) {
+                s.frame_length_min = reader.frame.length;
+            }
+            if (reader.frame.length > s.frame_length_max) {
+                s.frame_length_max = reader.frame.length;
+            }
+            s.frames++;
+            s.frame_bytes += reader.frame.length;
+            break;
+
+        case tinyframe_stopped:
+            s.bytes = reader.bytes_total;
+            *stats  = s;
+            if (!started || len > reader.bytes_read) {
+                trace("stop without start or data after stop, error");
+                return tinyframe_error;
+            }
+            return tinyframe_ok;
+
+        case tinyframe_need_more:
+            trace("truncated at %" PRIu64 ", need more", reader.bytes_total);
+            *stats = s;
+            return tinyframe_need_more;
+
+        default:
+            trace("%s at %" PRIu64 ", error", tinyframe_result_string[res], reader.bytes_total);
+            *stats = s;
+            return tinyframe_error;
+        }
+
+        s.bytes = reader.bytes_total;
+        data += reader.bytes_read;
+        len -= reader.bytes_read;
+    }
+}
+
 enum tinyframe_result tinyframe_write_control(struct tinyframe_writer* handle, uint8_t* out, size_t len, uint32_t type, const struct tinyframe_control_field* fields, size_t num_fields)
 {
     size_t   out_len = 12;
@@ -262,10 +395,12 @@ enum tinyframe_result tinyframe_write_control(struct tinyframe_writer* handle, u
             break;
         default:
             trace("field %zu type %d invalid, error", n, fields[n].type);
+            probe_write_error(type);
             return tinyframe_error;
         }
         if (fields[n].length > TINYFRAME_CONTROL_FIELD_CONTENT_TYPE_LENGTH_MAX) {
             trace("field %zu length > max, error", n);
+            probe_write_error(type);
             return tinyframe_error;
         }
         out_len += 8 + fields[n].length;
@@ -273,6 +408,7 @@ enum tinyframe_result tinyframe_write_control(struct tinyframe_writer* handle, u
 
     if (len < out_len) {
         trace("not enought space, need more");
+        probe_write_need_more(out_len, len);
         return tinyframe_need_more;
     }
 
@@ -292,76 +428,166 @@ enum tinyframe_result tinyframe_write_control(struct tinyframe_writer* handle, u
         outp += 8 + fields[n].length;
     }
 
-    handle->bytes_wrote = out_len;
+    __wrote(handle, out_len);
+    probe_write_control(type, out_len);
     trace("control %u data: %s", type, printable_string(out, handle->bytes_wrote));
     return tinyframe_ok;
 }
 
-enum tinyframe_result tinyframe_write_control_start(struct tinyframe_writer* handle, uint8_t* out, size_t len, const char* content_type, size_t content_type_len)
+static inline enum tinyframe_result __write_control_content_type(struct tinyframe_writer* handle, uint8_t* out, size_t len, uint32_t type, const char* content_type, size_t content_type_len)
 {
-    assert(handle);
-    assert(out);
-    assert(content_type);
-
     if (content_type_len > TINYFRAME_CONTROL_FIELD_CONTENT_TYPE_LENGTH_MAX) {
         trace("field length > max, error");
+        probe_write_error(type);
         return tinyframe_error;
     }
     if (len < 12 + 8 + content_type_len) {
         trace("not enought space, need more");
+        probe_write_need_more(12 + 8 + content_type_len, len);
         return tinyframe_need_more;
     }
 
     _put32(out, 0); // "escape"
     _put32(out + 4, 12 + 8 + content_type_len - 8); // length
     // - 8 is because "escape" and length is not included in length
-    _put32(out + 8, TINYFRAME_CONTROL_START); // type
+    _put32(out + 8, type); // type
     _put32(out + 12, TINYFRAME_CONTROL_FIELD_CONTENT_TYPE); // field type
     _put32(out + 16, content_type_len); // field length
     memcpy(out + 20, content_type, content_type_len); // field data
 
-    handle->bytes_wrote = 12 + 8 + content_type_len;
-    trace("control start data: %s", printable_string(out, handle->bytes_wrote));
+    __wrote(handle, 12 + 8 + content_type_len);
+    probe_write_control(type, handle->bytes_wrote);
+    trace("control %u data: %s", type, printable_string(out, handle->bytes_wrote));
+    return tinyframe_ok;
+}
+
+static inline enum tinyframe_result __write_control_empty(struct tinyframe_writer* handle, uint8_t* out, size_t len, uint32_t type)
+{
+    if (len < 12) {
+        trace("not enought space, need more");
+        probe_write_need_more(12, len);
+        return tinyframe_need_more;
+    }
+
+    _put32(out, 0); // "escape"
+    _put32(out + 4, 12 - 8); // length
+    // - 8 is because "escape" and length is not included in length
+    _put32(out + 8, type); // type
+
+    __wrote(handle, 12);
+    probe_write_control(type, handle->bytes_wrote);
+    trace("control %u data: %s", type, printable_string(out, handle->bytes_wrote));
     return tinyframe_ok;
 }
 
+enum tinyframe_result tinyframe_write_control_ready(struct tinyframe_writer* handle, uint8_t* out, size_t len, const char* content_type, size_t content_type_len)
+{
+    assert(handle);
+    assert(out);
+    assert(content_type);
+
+    return __write_control_content_type(handle, out, len, TINYFRAME_CONTROL_READY, content_type, content_type_len);
+}
+
+enum tinyframe_result tinyframe_write_control_accept(struct tinyframe_writer* handle, uint8_t* out, size_t len, const char* content_type, size_t content_type_len)
+{
+    assert(handle);
+    assert(out);
+    assert(content_type);
+
+    return __write_control_content_type(handle, out, len, TINYFRAME_CONTROL_ACCEPT, content_type, content_type_len);
+}
+
+enum tinyframe_result tinyframe_write_control_start(struct tinyframe_writer* handle, uint8_t* out, size_t len, const char* content_type, size_t content_type_len)
+{
+    assert(handle);
+    assert(out);
+    assert(content_type);
+
+    return __write_control_content_type(handle, out, len, TINYFRAME_CONTROL_START, content_type, content_type_len);
+}
+
 enum tinyframe_result tinyframe_write_frame(struct tinyframe_writer* handle, uint8_t* out, size_t len, const uint8_t* data, uint32_t data_len)
 {
     assert(handle);
     assert(out);
     assert(data);
 
-    if (len < 4 + data_len) {
+    if (len < 4 || len - 4 < data_len) {
         trace("not enought space, need more");
+        probe_write_need_more(4 + (uint64_t)data_len, len);
         return tinyframe_need_more;
     }
 
     _put32(out, data_len); // length
     memcpy(out + 4, data, data_len); // frame
 
-    handle->bytes_wrote = 4 + data_len;
+    __wrote(handle, 4 + (size_t)data_len);
+    probe_write_frame(data_len);
     trace("frame data: %s...", printable_string(out, handle->bytes_wrote > 20 ? 20 : handle->bytes_wrote));
     return tinyframe_ok;
 }
 
-enum tinyframe_result tinyframe_write_control_stop(struct tinyframe_writer* handle, uint8_t* out, size_t len)
+enum tinyframe_result tinyframe_write_frames(struct tinyframe_writer* handle, uint8_t* out, size_t len, const struct tinyframe* frames, size_t num_frames, size_t* written_frames)
 {
+    size_t   out_len = 0;
+    size_t   n, fit;
+    uint8_t* outp;
+
     assert(handle);
     assert(out);
+    assert(!num_frames || frames);
+    assert(written_frames);
+
+    // size the batch first, stop at the first frame that does not fit
+    for (fit = 0; fit < num_frames; fit++) {
+        if (!frames[fit].length) {
+            // a zero length would be read as the control frame "escape"
+            trace("frame %zu length zero, error", fit);
+            probe_write_error(0);
+            *written_frames = 0;
+            return tinyframe_error;
+        }
+        if (len - out_len < 4 || len - out_len - 4 < frames[fit].length) {
+            break;
+        }
+        out_len += 4 + (size_t)frames[fit].length;
+    }
 
-    if (len < 12) {
-        trace("not enought space, need more");
+    outp = out;
+    for (n = 0; n < fit; n++) {
+        assert(frames[n].data);
+        _put32(outp, frames[n].length); // length
+        memcpy(outp + 4, frames[n].data, frames[n].length); // frame
+        outp += 4 + (size_t)frames[n].length;
+        probe_write_frame(frames[n].length);
+    }
+
+    *written_frames = fit;
+    __wrote(handle, out_len);
+    if (fit < num_frames) {
+        trace("not enought space for all frames, wrote %zu of %zu, need more", fit, num_frames);
+        probe_write_need_more(out_len + 4 + (uint64_t)frames[fit].length, len);
         return tinyframe_need_more;
     }
+    trace("%zu frames, %zu bytes", fit, out_len);
+    return tinyframe_ok;
+}
 
-    _put32(out, 0); // "escape"
-    _put32(out + 4, 12 - 8); // length
-    // - 8 is because "escape" and length is not included in length
-    _put32(out + 8, TINYFRAME_CONTROL_STOP); // type
+enum tinyframe_result tinyframe_write_control_stop(struct tinyframe_writer* handle, uint8_t* out, size_t len)
+{
+    assert(handle);
+    assert(out);
 
-    handle->bytes_wrote = 12;
-    trace("control stop data: %s", printable_string(out, handle->bytes_wrote));
-    return tinyframe_ok;
+    return __write_control_empty(handle, out, len, TINYFRAME_CONTROL_STOP);
+}
+
+enum tinyframe_result tinyframe_write_control_finish(struct tinyframe_writer* handle, uint8_t* out, size_t len)
+{
+    assert(handle);
+    assert(out);
+
+    return __write_control_empty(handle, out, len, TINYFRAME_CONTROL_FINISH);
 }
 
 void tinyframe_set_header(uint8_t* frame, uint32_t frame_length)
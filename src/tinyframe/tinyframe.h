@@ -93,6 +93,9 @@ struct tinyframe_reader {
     struct tinyframe               frame;
 
     size_t bytes_read;
+    size_t bytes_needed;
+
+    uint64_t offset, bytes_total;
 };
 
 #define TINYFRAME_READER_INITIALIZER                                \
@@ -104,15 +107,38 @@ struct tinyframe_reader {
         .control_field       = TINYFRAME_CONTROL_FIELD_INITIALIZER, \
         .frame               = TINYFRAME_INITIALIZER,               \
         .bytes_read          = 0,                                   \
+        .bytes_needed        = 0,                                   \
+        .offset              = 0,                                   \
+        .bytes_total         = 0,                                   \
     }
 
 struct tinyframe_writer {
     size_t bytes_wrote;
+
+    uint64_t offset, bytes_total;
 };
 
 #define TINYFRAME_WRITER_INITIALIZER \
     {                                \
         .bytes_wrote = 0,            \
+        .offset      = 0,            \
+        .bytes_total = 0,            \
+    }
+
+struct tinyframe_stats {
+    uint64_t frames, frame_bytes;
+    uint32_t frame_length_min, frame_length_max;
+
+    uint64_t bytes;
+};
+
+#define TINYFRAME_STATS_INITIALIZER \
+    {                               \
+        .frames           = 0,      \
+        .frame_bytes      = 0,      \
+        .frame_length_min = 0,      \
+        .frame_length_max = 0,      \
+        .bytes            = 0,      \
     }
 
 enum tinyframe_result {
@@ -128,12 +154,18 @@ enum tinyframe_result {
 extern const char* const tinyframe_result_string[];
 
 enum tinyframe_result tinyframe_read(struct tinyframe_reader*, const uint8_t*, size_t);
+void tinyframe_reader_reset(struct tinyframe_reader*);
+enum tinyframe_result tinyframe_verify(const uint8_t*, size_t, struct tinyframe_stats*);
 
 enum tinyframe_result tinyframe_write_control(struct tinyframe_writer*, uint8_t*, size_t, uint32_t, const struct tinyframe_control_field*, size_t);
 
+enum tinyframe_result tinyframe_write_control_ready(struct tinyframe_writer*, uint8_t*, size_t, const char*, size_t);
+enum tinyframe_result tinyframe_write_control_accept(struct tinyframe_writer*, uint8_t*, size_t, const char*, size_t);
 enum tinyframe_result tinyframe_write_control_start(struct tinyframe_writer*, uint8_t*, size_t, const char*, size_t);
 enum tinyframe_result tinyframe_write_frame(struct tinyframe_writer*, uint8_t*, size_t, const uint8_t*, uint32_t);
+enum tinyframe_result tinyframe_write_frames(struct tinyframe_writer*, uint8_t*, size_t, const struct tinyframe*, size_t, size_t*);
 enum tinyframe_result tinyframe_write_control_stop(struct tinyframe_writer*, uint8_t*, size_t);
+enum tinyframe_result tinyframe_write_control_finish(struct tinyframe_writer*, uint8_t*, size_t);
 
 void tinyframe_set_header(uint8_t*, uint32_t);
 